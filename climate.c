@@ -10,10 +10,42 @@
  * Input:    Tab-delimited file(s) to analyze.
  * Output:   Summary information about the data.
  *
- * Compile:  run make
+ * Compile:  run make (gcc -pthread -o climate climate.c libclimate.c -lm)
+ *
+ * The parsing and aggregation live in libclimate.c so other programs can
+ * push TDV buffers into it directly; this file is the command line front
+ * end and the daemon.
  *
  * Example Run:      ./climate data_tn.tdv data_wa.tdv
  *
+ * Options:  --dedup   Drop records whose (state, timestamp, geolocation)
+ *                     has already been seen, so overlapping files can be
+ *                     passed together without double counting.
+ *           --daemon <socket>
+ *                     Stay resident after reading the files, follow them as
+ *                     they grow and answer queries on a Unix domain socket.
+ *                     Queries are one line each: "report" for the full
+ *                     report or "state <code>" for a single state, e.g.
+ *                         echo report | nc -U /tmp/climate.sock
+ *                     Only complete lines are counted, so a record that is
+ *                     still being written is picked up on the next change.
+ *                     A file that shrinks is read again from the start.
+ *           --sample <blocks>
+ *                     Quick estimate instead of the exact report: reads only
+ *                     <blocks> randomly chosen 4 KiB blocks of each file
+ *                     and scales the counts up. Each estimate is followed
+ *                     by its 95% confidence interval, e.g.
+ *                         Number of Records: 48212 +/- 905
+ *                     Max and min temperatures are the extremes among the
+ *                     sampled records. Runs in time proportional to the
+ *                     number of blocks, not the file sizes. Neither --dedup
+ *                     nor --daemon can be combined with it.
+ *           --check   Check libclimate's merge instead of printing the
+ *                     report: each file is split in two at a line boundary,
+ *                     two threads push the halves into their own contexts
+ *                     in small uneven pieces, and the merged result must
+ *                     match a single context that read the files whole.
+ *
  *
  * Opening file: data_tn.tdv
  * Opening file: data_wa.tdv
@@ -66,52 +98,240 @@
  *      surface temperature (Kelvin)
  */
 
-#include <float.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <time.h>
+#include <unistd.h>
+
+#include "libclimate.h"
+
+/* Files are pushed into the library in blocks of this many bytes */
+#define READ_SZ 65536
 
-#define NUM_STATES 50
+/* Rough size of one TDV line, used to size the dedup set from file sizes */
+#define APPROX_LINE_SZ 60
+
+/* Block size for --sample */
+#define SAMPLE_BLOCK_SZ 4096
+
+/* Normal quantile for a 95% confidence interval */
+#define Z_95 1.96
+
+/* Fields estimated in --sample mode, besides the record count */
+enum sample_field {
+    SAMPLE_TEMP,
+    SAMPLE_HUMIDITY,
+    SAMPLE_CLOUD,
+    SAMPLE_STRIKES,
+    SAMPLE_SNOW,
+    NUM_SAMPLE_FIELDS
+};
 
-struct climate_info {
+/* Sums over the sampled blocks of one file for one state, where y is the
+ * number of records in a block and x the block's sum of each field. The
+ * squares and products give the spread between blocks. */
+struct sample_sums {
+    double y, yy;
+    double x[NUM_SAMPLE_FIELDS];
+    double xx[NUM_SAMPLE_FIELDS];
+    double xy[NUM_SAMPLE_FIELDS];
+};
+
+/* A file in --sample mode: how many blocks it has, how many were read and
+ * the sums for each state, indexed like the states of the report */
+struct sampled_file {
+    long num_blocks;
+    long num_sampled;
+    struct sample_sums states[CLIMATE_NUM_STATES];
+};
+
+/* Extremes of one state among the sampled records */
+struct sample_state {
     char code[3];
-    unsigned long num_records;
-    double sum_temp;
     double max_temp;
     double min_temp;
-    char* min_temp_time;
-    char* max_temp_time;
-    unsigned long sum_humidity;
-    unsigned long sum_strikes;
-    unsigned long sum_snow;
-    unsigned long sum_cloud;
+    time_t max_temp_time;
+    time_t min_temp_time;
+};
+
+/* An estimate and the half width of its confidence interval */
+struct sample_estimate {
+    double value;
+    double error;
+};
+
+/* Piece size for --check, small and uneven so records straddle pushes */
+#define CHECK_PUSH_SZ 1013
+
+/* One thread's share of the files in --check mode. half 0 reads the first
+ * part of every file, half 1 the rest. */
+struct check_half {
+    char **files;
+    int num_files;
+    int half;
+    struct climate_ctx *ctx;
+};
+
+/* Clients the daemon is waiting on at once, and how long a client may take
+ * to send its query before it is dropped */
+#define MAX_CLIENTS 64
+#define CLIENT_TIMEOUT_MS 200
+
+/* A connection whose query has not fully arrived yet. deadline is in
+ * milliseconds on the monotonic clock. */
+struct pending_client {
+    int fd;
+    size_t len;
+    char query[64];
+    long long deadline;
+};
+
+/* A file followed in daemon mode. offset is how far the file has been
+ * read; watch is the inotify watch descriptor for the file. skipping is
+ * set while offset is inside a line too long to be a record. */
+struct followed_file {
+    const char *path;
+    FILE *fileptr;
+    long offset;
+    int watch;
+    int skipping;
 };
 
 // Function Prototypes
-void analyze_file(FILE *file, struct climate_info *states[], int num_states);
-void print_report(struct climate_info *states[], int num_states);
-char* timeToString(char* time);
-double KtoF(double K);
+void analyze_file(FILE *file, struct climate_ctx *ctx);
+void print_report(FILE *out, const struct climate_snapshot *snap);
+void print_state(FILE *out, const struct climate_info *info);
+int run_daemon(const char *socket_path, char *files[], int num_files,
+               struct climate_ctx *ctx, int dedup);
+void follow_file(struct followed_file *followed, struct climate_ctx *ctx);
+int read_query(struct pending_client *client);
+void answer_query(int client, const char *query, struct climate_ctx *ctx,
+                  int dedup);
+long long now_ms(void);
+char* timeToString(time_t timestamp, char *buf);
+long file_size(const char *path);
+int run_sample(char *files[], int num_files, long blocks_per_file);
+int run_check(char *files[], int num_files);
+void* check_thread(void *arg);
+long split_offset(FILE *file, long size);
+int same_state(const struct climate_info *a, const struct climate_info *b);
+int choose_blocks(long num_blocks, long num_sampled, uint64_t *random_state,
+                  long *blocks);
+int compare_blocks(const void *a, const void *b);
+void sample_block(FILE *file, long offset, struct climate_ctx *ctx);
+double covariance(double sum_a, double sum_b, double sum_ab, long n);
+double variance_scale(const struct sampled_file *file);
+struct sample_estimate estimate_total(const struct sampled_file *files,
+                                      int num_files, int k, int field);
+struct sample_estimate estimate_ratio(const struct sampled_file *files,
+                                      int num_files, int k, int field);
+uint64_t next_random(uint64_t *state);
 
 
 int main(int argc, char *argv[]) 
 {
+  int dedup = 0;
+  const char *socket_path = NULL;
+  long sample_blocks = 0;
+  int check = 0;
+  char **files = calloc(argc, sizeof(char*));
+  int num_files = 0;
+  if (files == NULL) {
+    printf("Not enough memory to analyze the files.\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--dedup")) {
+      dedup = 1;
+    } else if (!strcmp(argv[i], "--daemon") && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (!strcmp(argv[i], "--sample") && i + 1 < argc) {
+      sample_blocks = atol(argv[++i]);
+      if (sample_blocks < 1) {
+        printf("--sample needs a number of blocks\n");
+        free(files);
+        return EXIT_FAILURE;
+      }
+    } else if (!strcmp(argv[i], "--check")) {
+      check = 1;
+    } else {
+      files[num_files++] = argv[i];
+    }
+  }
+
   //Program must read at least 1 file to be able to run  
-  if (argc < 2){
+  if (num_files < 1){
     printf("At least 1 file must be opened!\n");
+    free(files);
     return EXIT_FAILURE;
   }
 
-  /* Let's create an array to store our state data in. As we know, there are
-    * 50 US states. */
-  struct climate_info *states[NUM_STATES] = { NULL };
+  if (check) {
+    int status = run_check(files, num_files);
+    free(files);
+    return status;
+  }
 
-  for (int i = 1; i < argc; ++i) {
+  if (sample_blocks > 0) {
+    if (socket_path != NULL) {
+      printf("--sample cannot be combined with --daemon\n");
+      free(files);
+      return EXIT_FAILURE;
+    }
+    //sampled blocks cannot tell which records repeat elsewhere in the files
+    if (dedup) {
+      printf("--sample cannot be combined with --dedup\n");
+      free(files);
+      return EXIT_FAILURE;
+    }
+    int status = run_sample(files, num_files, sample_blocks);
+    free(files);
+    return status;
+  }
+
+  /* The dedup set is sized from the total input so it rarely has to grow */
+  unsigned long total_bytes = 0;
+  if (dedup) {
+    for (int i = 0; i < num_files; ++i) {
+      long size = file_size(files[i]);
+      if (size > 0) {
+        total_bytes += size;
+      }
+    }
+  }
+
+  /* All the state data is kept in a libclimate context */
+  struct climate_ctx *ctx = climate_ctx_create(dedup ? CLIMATE_DEDUP : 0,
+                                               total_bytes / APPROX_LINE_SZ);
+  if (ctx == NULL) {
+    printf("Not enough memory to analyze the files.\n");
+    free(files);
+    return EXIT_FAILURE;
+  }
+
+  if (socket_path != NULL) {
+    int status = run_daemon(socket_path, files, num_files, ctx, dedup);
+    climate_ctx_destroy(ctx);
+    free(files);
+    return status;
+  }
+
+  for (int i = 0; i < num_files; ++i) {
     /* Opens the file for reading */
-    FILE* fileptr = fopen(argv[i], "r");
+    FILE* fileptr = fopen(files[i], "r");
 
-    printf("Opening file: %s\n", argv[i]);
+    printf("Opening file: %s\n", files[i]);
 
     /* If the file doesn't exist, an error message is printed and the
     program moves on to the next file. */
@@ -122,7 +342,7 @@ int main(int argc, char *argv[])
     else {
 
       /* Analyzes the file */
-      analyze_file(fileptr, states, NUM_STATES); 
+      analyze_file(fileptr, ctx); 
 
       //closes file to free memory
       fclose(fileptr);
@@ -130,144 +350,813 @@ int main(int argc, char *argv[])
   }
 
   /* Now that we have recorded data for each file, we'll summarize them: */
-  print_report(states, NUM_STATES);
+  struct climate_snapshot snap;
+  climate_ctx_snapshot(ctx, &snap);
+  if (dedup) {
+    printf("Duplicate records dropped: %lu\n", snap.num_dropped);
+  }
+  print_report(stdout, &snap);
 
+  climate_ctx_destroy(ctx);
+  free(files);
   return 0;
 }
 
-void analyze_file(FILE *file, struct climate_info **states, int num_states){
-  const int line_sz = 100;
-  char line[line_sz];
-  char* token;
-  while (fgets(line, line_sz, file) != NULL) {
+//Pushes the whole file into the context
+void analyze_file(FILE *file, struct climate_ctx *ctx){
+  char buf[READ_SZ];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+    climate_ctx_push(ctx, buf, len);
+  }
+  //the last line may not end in a newline
+  climate_ctx_flush(ctx);
+}
+
+//prints out the summary for each state. See format above
+void print_report(FILE *out, const struct climate_snapshot *snap) {
+  fprintf(out, "States found: ");
+  for (int i = 0; i < snap->num_states; i++) {
+      fprintf(out, "%s ", snap->states[i].code);
+  }
+  fprintf(out, "\n");
+
+  for (int i = 0; i < snap->num_states; i++) {
+    print_state(out, &snap->states[i]);
+  }
+}
 
-    token = strtok(line, " \t\n"); //getting code
-    char* temp_time = NULL;
-    int found_index = -1; //set to -1, meaning not yet found
+//prints out the summary for a single state
+void print_state(FILE *out, const struct climate_info *info) {
+  char time_buf[32];
+  fprintf(out, "-- State: %s --\n", info->code);
+  fprintf(out, "Number of Records: %ld\n", info->num_records);
+  fprintf(out, "Average Humidity: %.1f%%\n", (double) info->sum_humidity/info->num_records);
+  double avg_temp = info->sum_temp/info->num_records;
+  fprintf(out, "Average Temperature: %.1fF\n", avg_temp);
+  fprintf(out, "Max Temperature: %.1fF\n", (double) info->max_temp);
+  fprintf(out, "Max Temperature on: %s\n", timeToString(info->max_temp_time, time_buf));
+  fprintf(out, "Min Temperature: %.1fF\n", (double) info->min_temp);
+  fprintf(out, "Min Temperature on: %s\n", timeToString(info->min_temp_time, time_buf));
+  fprintf(out, "Lightning Strikes: %.lu\n", info->sum_strikes);
+  fprintf(out, "Records with Snow Cover: %.lu\n", info->sum_snow);
+  fprintf(out, "Average Cloud Cover: %.1f%%\n", (double) info->sum_cloud/info->num_records);
+}
 
-    for (int i = 0; i < num_states; i++){
+/* Reads the files into one context on this thread, and again split
+ * between two threads with a context each, then merges the two and
+ * compares the states with the single context. Prints the outcome and
+ * returns 0 if they match. */
+int run_check(char *files[], int num_files) {
+  struct climate_ctx *whole = climate_ctx_create(0, 0);
+  struct check_half halves[2];
+  for (int h = 0; h < 2; ++h) {
+    halves[h].files = files;
+    halves[h].num_files = num_files;
+    halves[h].half = h;
+    halves[h].ctx = climate_ctx_create(0, 0);
+  }
+  if (whole == NULL || halves[0].ctx == NULL || halves[1].ctx == NULL) {
+    printf("Not enough memory to analyze the files.\n");
+    climate_ctx_destroy(whole);
+    climate_ctx_destroy(halves[0].ctx);
+    climate_ctx_destroy(halves[1].ctx);
+    return EXIT_FAILURE;
+  }
 
-      //state code is found in states array
-      if (*(states + i) != NULL && !strcmp((*states + i)->code, token)){
-        found_index = i;
+  for (int i = 0; i < num_files; ++i) {
+    FILE* fileptr = fopen(files[i], "r");
+    printf("Opening file: %s\n", files[i]);
+    if (fileptr == NULL) {
+      printf("File cannot be opened.\n");
+      continue;
+    }
+    analyze_file(fileptr, whole);
+    fclose(fileptr);
+  }
+
+  pthread_t threads[2];
+  for (int h = 0; h < 2; ++h) {
+    pthread_create(&threads[h], NULL, check_thread, &halves[h]);
+  }
+  for (int h = 0; h < 2; ++h) {
+    pthread_join(threads[h], NULL);
+  }
+  int status = climate_ctx_merge(halves[0].ctx, halves[1].ctx);
+
+  struct climate_snapshot expected, merged;
+  climate_ctx_snapshot(whole, &expected);
+  climate_ctx_snapshot(halves[0].ctx, &merged);
+  climate_ctx_destroy(whole);
+  climate_ctx_destroy(halves[0].ctx);
+  climate_ctx_destroy(halves[1].ctx);
+
+  //the merged states may come in a different order
+  int mismatches = 0;
+  if (status < 0 || merged.num_states != expected.num_states) {
+    printf("Merge check: %d states merged, %d expected\n",
+           merged.num_states, expected.num_states);
+    mismatches++;
+  }
+  for (int i = 0; i < expected.num_states; ++i) {
+    const struct climate_info *found = NULL;
+    for (int j = 0; j < merged.num_states && found == NULL; ++j) {
+      if (!strcmp(merged.states[j].code, expected.states[i].code)) {
+        found = &merged.states[j];
+      }
+    }
+    if (found == NULL || !same_state(found, &expected.states[i])) {
+      printf("Merge check: state %s differs\n", expected.states[i].code);
+      mismatches++;
+    }
+  }
+  printf("Merge check %s (%d states)\n", mismatches ? "FAILED" : "passed",
+         expected.num_states);
+  return mismatches ? EXIT_FAILURE : 0;
+}
+
+//Pushes one half of every file into the thread's own context
+void* check_thread(void *arg) {
+  struct check_half *half = arg;
+  char buf[CHECK_PUSH_SZ];
+
+  for (int i = 0; i < half->num_files; ++i) {
+    FILE* fileptr = fopen(half->files[i], "r");
+    if (fileptr == NULL) {
+      continue;
+    }
+    fseek(fileptr, 0, SEEK_END);
+    long size = ftell(fileptr);
+    long split = split_offset(fileptr, size);
+    long pos = half->half == 0 ? 0 : split;
+    long end = half->half == 0 ? split : size;
+
+    fseek(fileptr, pos, SEEK_SET);
+    while (pos < end) {
+      size_t want = end - pos < (long) sizeof(buf) ? (size_t) (end - pos) : sizeof(buf);
+      size_t len = fread(buf, 1, want, fileptr);
+      if (len == 0) {
         break;
       }
+      climate_ctx_push(half->ctx, buf, len);
+      pos += len;
+    }
+    climate_ctx_flush(half->ctx);
+    fclose(fileptr);
+  }
+  return NULL;
+}
+
+//Offset of the first line starting at or after the middle of the file
+long split_offset(FILE *file, long size) {
+  if (size <= 1) {
+    return size;
+  }
+  fseek(file, size / 2 - 1, SEEK_SET);
+  int c;
+  while ((c = getc(file)) != EOF && c != '\n') {
+  }
+  return ftell(file);
+}
+
+/* Compares two states. The temperature sum is added up in a different
+ * order, so it only has to agree to rounding. */
+int same_state(const struct climate_info *a, const struct climate_info *b) {
+  return a->num_records == b->num_records
+         && fabs(a->sum_temp - b->sum_temp) <= 1e-9 * fabs(b->sum_temp)
+         && a->max_temp == b->max_temp
+         && a->min_temp == b->min_temp
+         && a->sum_humidity == b->sum_humidity
+         && a->sum_strikes == b->sum_strikes
+         && a->sum_snow == b->sum_snow
+         && a->sum_cloud == b->sum_cloud;
+}
+
+/* Estimates the report from randomly chosen blocks of each file. Each file
+ * is cut into SAMPLE_BLOCK_SZ blocks and blocks_per_file of them are read;
+ * a block holds the records whose line starts inside it. The files are
+ * sampled independently, so the estimates add up file by file. Counts and
+ * sums are scaled up by blocks in file / blocks read, averages are the
+ * ratio of two scaled sums. */
+int run_sample(char *files[], int num_files, long blocks_per_file) {
+  struct sampled_file *sampled = calloc(num_files, sizeof(struct sampled_file));
+  if (sampled == NULL) {
+    printf("Not enough memory to analyze the files.\n");
+    return EXIT_FAILURE;
+  }
+  struct sample_state states[CLIMATE_NUM_STATES];
+  int num_states = 0;
+  long *blocks = NULL;
+  long total_read = 0, total_blocks = 0;
+  uint64_t random_state = (uint64_t) time(NULL) ^ ((uint64_t) getpid() << 32);
+
+  for (int i = 0; i < num_files; ++i) {
+    FILE* fileptr = fopen(files[i], "r");
+
+    printf("Opening file: %s\n", files[i]);
+    if (fileptr == NULL) {
+      printf("File cannot be opened.\n");
+      continue;
+    }
+    fseek(fileptr, 0, SEEK_END);
+    long size = ftell(fileptr);
+
+    /* At least two blocks, or the spread between blocks is unknown */
+    long num_blocks = (size + SAMPLE_BLOCK_SZ - 1) / SAMPLE_BLOCK_SZ;
+    long num_sampled = blocks_per_file < 2 ? 2 : blocks_per_file;
+    if (num_sampled > num_blocks) {
+      num_sampled = num_blocks;
+    }
+    sampled[i].num_blocks = num_blocks;
+    sampled[i].num_sampled = num_sampled;
+    if (num_sampled == 0) {
+      fclose(fileptr);
+      continue;
+    }
+
+    long *grown = realloc(blocks, num_sampled * sizeof(long));
+    if (grown == NULL) {
+      printf("Not enough memory to analyze the files.\n");
+      fclose(fileptr);
+      free(blocks);
+      free(sampled);
+      return EXIT_FAILURE;
+    }
+    blocks = grown;
+    if (choose_blocks(num_blocks, num_sampled, &random_state, blocks) < 0) {
+      printf("Not enough memory to analyze the files.\n");
+      fclose(fileptr);
+      free(blocks);
+      free(sampled);
+      return EXIT_FAILURE;
     }
+    for (long b = 0; b < num_sampled; ++b) {
+      struct climate_ctx *block = climate_ctx_create(0, 0);
+      if (block == NULL) {
+        printf("Not enough memory to analyze the files.\n");
+        fclose(fileptr);
+        free(blocks);
+        free(sampled);
+        return EXIT_FAILURE;
+      }
+      sample_block(fileptr, blocks[b] * SAMPLE_BLOCK_SZ, block);
+      struct climate_snapshot snap;
+      climate_ctx_snapshot(block, &snap);
+      climate_ctx_destroy(block);
+
+      for (int s = 0; s < snap.num_states; ++s) {
+        const struct climate_info *info = &snap.states[s];
+        int k = 0;
+        while (k < num_states && strcmp(states[k].code, info->code)) {
+          k++;
+        }
+        if (k == CLIMATE_NUM_STATES) {
+          continue;
+        }
+        if (k == num_states) {
+          strcpy(states[k].code, info->code);
+          states[k].max_temp = info->max_temp;
+          states[k].min_temp = info->min_temp;
+          states[k].max_temp_time = info->max_temp_time;
+          states[k].min_temp_time = info->min_temp_time;
+          num_states++;
+        }
+        if (info->max_temp > states[k].max_temp) {
+          states[k].max_temp = info->max_temp;
+          states[k].max_temp_time = info->max_temp_time;
+        }
+        if (info->min_temp < states[k].min_temp) {
+          states[k].min_temp = info->min_temp;
+          states[k].min_temp_time = info->min_temp_time;
+        }
 
-    //if state code is not found in states array, create new one
-    if (found_index < 0){
-      for (int i = 0; i < num_states && found_index < 0; i++){
-        if (*(states + i) == NULL){
-          *(states + i) = calloc(num_states, sizeof(struct climate_info));
-          found_index = i;
-          (*states + found_index)->num_records = 0;
-          (*states + found_index)->sum_temp = 0;
-
-          /* Not an elegant way to set default values for temperatures, but
-          the temperatures set to values that are are out of this world so 
-          that the first temperature processed from the file will act as default */ 
-          (*states + found_index)->max_temp = -1000;
-          (*states + found_index)->min_temp = 1000;
-
-          (*states + found_index)->sum_humidity = 0;
-          (*states + found_index)->sum_snow = 0;
-          (*states + found_index)->sum_cloud = 0;
-          (*states + found_index)->sum_strikes = 0;
-          (*states + found_index)->max_temp_time = calloc(30, sizeof(char));
-          (*states + found_index)->min_temp_time = calloc(30, sizeof(char));
-          strcpy((*states + found_index)->code, token);
+        /* y is the block's record count, x the block's sum of each field */
+        struct sample_sums *sums = &sampled[i].states[k];
+        double y = info->num_records;
+        double x[NUM_SAMPLE_FIELDS];
+        x[SAMPLE_TEMP] = info->sum_temp;
+        x[SAMPLE_HUMIDITY] = info->sum_humidity;
+        x[SAMPLE_CLOUD] = info->sum_cloud;
+        x[SAMPLE_STRIKES] = info->sum_strikes;
+        x[SAMPLE_SNOW] = info->sum_snow;
+        sums->y += y;
+        sums->yy += y * y;
+        for (int f = 0; f < NUM_SAMPLE_FIELDS; ++f) {
+          sums->x[f] += x[f];
+          sums->xx[f] += x[f] * x[f];
+          sums->xy[f] += x[f] * y;
         }
       }
     }
+    total_read += num_sampled;
+    total_blocks += num_blocks;
+    fclose(fileptr);
+  }
+
+  printf("Sampled %ld of %ld blocks (%.1f%%), estimates are +/- a 95%% confidence interval\n",
+         total_read, total_blocks,
+         total_blocks > 0 ? 100.0 * total_read / total_blocks : 0.0);
+  printf("States found: ");
+  for (int k = 0; k < num_states; k++) {
+    printf("%s ", states[k].code);
+  }
+  printf("\n");
+
+  char time_buf[32];
+  for (int k = 0; k < num_states; k++) {
+    struct sample_estimate count = estimate_total(sampled, num_files, k, -1);
+    struct sample_estimate humidity = estimate_ratio(sampled, num_files, k, SAMPLE_HUMIDITY);
+    struct sample_estimate temp = estimate_ratio(sampled, num_files, k, SAMPLE_TEMP);
+    struct sample_estimate strikes = estimate_total(sampled, num_files, k, SAMPLE_STRIKES);
+    struct sample_estimate snow = estimate_total(sampled, num_files, k, SAMPLE_SNOW);
+    struct sample_estimate cloud = estimate_ratio(sampled, num_files, k, SAMPLE_CLOUD);
 
-    (*states + found_index)->num_records+= 1;
+    printf("-- State: %s --\n", states[k].code);
+    printf("Number of Records: %.0f +/- %.0f\n", count.value, count.error);
+    printf("Average Humidity: %.1f%% +/- %.1f\n", humidity.value, humidity.error);
+    printf("Average Temperature: %.1fF +/- %.1f\n", temp.value, temp.error);
+    printf("Max Temperature in sample: %.1fF\n", states[k].max_temp);
+    printf("Max Temperature on: %s\n", timeToString(states[k].max_temp_time, time_buf));
+    printf("Min Temperature in sample: %.1fF\n", states[k].min_temp);
+    printf("Min Temperature on: %s\n", timeToString(states[k].min_temp_time, time_buf));
+    printf("Lightning Strikes: %.0f +/- %.0f\n", strikes.value, strikes.error);
+    printf("Records with Snow Cover: %.0f +/- %.0f\n", snow.value, snow.error);
+    printf("Average Cloud Cover: %.1f%% +/- %.1f\n", cloud.value, cloud.error);
+  }
 
-    token = strtok(NULL, " \t\n");
-    //time is extracted from string
-    temp_time = token;
+  free(blocks);
+  free(sampled);
+  return 0;
+}
 
-    token = strtok(NULL, " \t\n");
-    //geolocation is extracted, but will be unused
+/* Picks num_sampled distinct blocks out of num_blocks (Floyd's algorithm)
+ * and leaves them in ascending order, so the file is read front to back.
+ * The picks so far are kept in an open-addressing set, so choosing costs
+ * O(n log n) for the final sort. Returns -1 if out of memory. */
+int choose_blocks(long num_blocks, long num_sampled, uint64_t *random_state,
+                  long *blocks) {
+  size_t cap = 16;
+  while (cap < 2 * (size_t) num_sampled) {
+    cap *= 2;
+  }
+  long *chosen = malloc(cap * sizeof(long));
+  if (chosen == NULL) {
+    return -1;
+  }
+  memset(chosen, 0xff, cap * sizeof(long));   //all slots -1, empty
 
-    token = strtok(NULL, " \t\n");
-    //humidity is extracted
-    (*states + found_index)->sum_humidity += atol(token);
+  long count = 0;
+  for (long j = num_blocks - num_sampled; j < num_blocks; ++j) {
+    long pick = (long) (next_random(random_state) % (uint64_t) (j + 1));
 
-    token = strtok(NULL, " \t\n");
-    //snow is extracted
-    if (atol(token)) {
-      (*states + found_index)->sum_snow+= 1;
+    //if pick was taken, j is new: it is larger than any earlier pick
+    for (int pass = 0; pass < 2; ++pass) {
+      size_t slot = ((uint64_t) pick * 0x9E3779B97F4A7C15ULL) >> 20 & (cap - 1);
+      while (chosen[slot] >= 0 && chosen[slot] != pick) {
+        slot = (slot + 1) & (cap - 1);
+      }
+      if (chosen[slot] < 0) {
+        chosen[slot] = pick;
+        blocks[count++] = pick;
+        break;
+      }
+      pick = j;
     }
+  }
+  free(chosen);
 
-    token = strtok(NULL, " \t\n");
-    //cloud is extracted
-    (*states + found_index)->sum_cloud += atol(token);
+  qsort(blocks, count, sizeof(long), compare_blocks);
+  return 0;
+}
+
+//Orders block numbers for qsort
+int compare_blocks(const void *a, const void *b) {
+  long x = *(const long*) a, y = *(const long*) b;
+  return (x > y) - (x < y);
+}
 
-    token = strtok(NULL, " \t\n");
-    //lightning is extracted
-    if (atol(token)) {
-      (*states + found_index)->sum_strikes+= 1;
+/* Pushes the records of the block at offset into ctx: the lines that start
+ * inside the block, including the rest of the last one. */
+void sample_block(FILE *file, long offset, struct climate_ctx *ctx) {
+  char buf[SAMPLE_BLOCK_SZ + 1];
+  size_t start = 0;
+  size_t len;
+
+  if (offset == 0) {
+    fseek(file, 0, SEEK_SET);
+    len = fread(buf, 1, SAMPLE_BLOCK_SZ, file);
+  } else {
+    //the byte before the block tells whether a line starts right at it
+    fseek(file, offset - 1, SEEK_SET);
+    len = fread(buf, 1, SAMPLE_BLOCK_SZ + 1, file);
+    char *newline = memchr(buf, '\n', len);
+    if (newline == NULL) {
+      return;
     }
+    start = newline - buf + 1;
+  }
+  climate_ctx_push(ctx, buf + start, len - start);
+
+  //the last line runs into the next block
+  if (len > start && buf[len - 1] != '\n') {
+    char rest[256];
+    while (fgets(rest, sizeof(rest), file) != NULL) {
+      size_t rest_len = strlen(rest);
+      climate_ctx_push(ctx, rest, rest_len);
+      if (rest[rest_len - 1] == '\n') {
+        break;
+      }
+    }
+  }
+  climate_ctx_flush(ctx);
+}
 
-    token = strtok(NULL, " \t\n");
-    //pressure is extracted, but will be unused
+/* Sample covariance of two block values from their sums */
+double covariance(double sum_a, double sum_b, double sum_ab, long n) {
+  return (sum_ab - sum_a * sum_b / n) / (n - 1);
+}
 
-    token = strtok(NULL, " \t\n");
-    //surface temp is extracted as Kelvin
-    double temp_F = KtoF(atof(token)); //converted to Fahrenheit
-    char* string_time = timeToString(temp_time);// convert UNIX time to ctime format
-    (*states + found_index)->sum_temp += temp_F;
-    if (temp_F > (*states + found_index)->max_temp){ //set max temp
-      (*states + found_index)-> max_temp = temp_F;
-      strcpy((*states + found_index)-> max_temp_time, string_time);
+/* Scale of a file's sample variance in the variance of its estimated total,
+ * N^2 (1 - n/N) / n. Zero when the whole file was read. */
+double variance_scale(const struct sampled_file *file) {
+  double n = file->num_sampled, N = file->num_blocks;
+  if (n <= 1) {
+    return 0;
+  }
+  return N * N * (1 - n / N) / n;
+}
+
+/* Estimated total of a field over all the files for state k, or of the
+ * record count when field is -1 */
+struct sample_estimate estimate_total(const struct sampled_file *files,
+                                      int num_files, int k, int field) {
+  double total = 0, variance = 0;
+  for (int i = 0; i < num_files; ++i) {
+    const struct sample_sums *sums = &files[i].states[k];
+    if (files[i].num_sampled == 0) {
+      continue;
     }
-    if (temp_F < (*states + found_index)->min_temp){ //set min temp
-      (*states + found_index)-> min_temp = temp_F;
-      strcpy((*states + found_index)-> min_temp_time, string_time);
+    double sum = field < 0 ? sums->y : sums->x[field];
+    double sum_sq = field < 0 ? sums->yy : sums->xx[field];
+    total += sum * files[i].num_blocks / files[i].num_sampled;
+    if (files[i].num_sampled > 1) {
+      variance += variance_scale(&files[i])
+                  * covariance(sum, sum, sum_sq, files[i].num_sampled);
     }
   }
+  struct sample_estimate estimate = { total, Z_95 * sqrt(variance) };
+  return estimate;
 }
 
-//prints out the summary for each state. See format above
-void print_report(struct climate_info *states[], int num_states) {
-  printf("States found: ");
-  for (int i = 0; i < num_states; i++) {
-      if (states[i] != NULL) {
-          struct climate_info *info = (*states + i);
-          printf("%s ", info->code);
+/* Estimated average of a field per record for state k: estimated total of
+ * the field over estimated number of records. The variance is the usual
+ * linearization, from the spread of the residuals x - average * y. */
+struct sample_estimate estimate_ratio(const struct sampled_file *files,
+                                      int num_files, int k, int field) {
+  struct sample_estimate count = estimate_total(files, num_files, k, -1);
+  struct sample_estimate total = estimate_total(files, num_files, k, field);
+  double ratio = total.value / count.value;
+  double variance = 0;
+  for (int i = 0; i < num_files; ++i) {
+    const struct sample_sums *sums = &files[i].states[k];
+    long n = files[i].num_sampled;
+    if (n <= 1) {
+      continue;
+    }
+    double var_x = covariance(sums->x[field], sums->x[field], sums->xx[field], n);
+    double var_y = covariance(sums->y, sums->y, sums->yy, n);
+    double cov_xy = covariance(sums->x[field], sums->y, sums->xy[field], n);
+    double residual = var_x - 2 * ratio * cov_xy + ratio * ratio * var_y;
+    if (residual > 0) {
+      variance += variance_scale(&files[i]) * residual;
+    }
+  }
+  struct sample_estimate estimate = { ratio, Z_95 * sqrt(variance) / count.value };
+  return estimate;
+}
+
+//64-bit generator (splitmix64) for picking blocks
+uint64_t next_random(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+//Set from the signal handler to make the daemon loop exit
+static volatile sig_atomic_t daemon_stop = 0;
+
+void handle_stop(int signum) {
+  (void) signum;
+  daemon_stop = 1;
+}
+
+/* Keeps the states resident, follows the files with inotify and answers
+ * queries on a Unix domain socket until SIGINT or SIGTERM. Every query is
+ * answered from the in-memory aggregates, no file is scanned again. */
+int run_daemon(const char *socket_path, char *files[], int num_files,
+               struct climate_ctx *ctx, int dedup) {
+  struct sockaddr_un addr = { 0 };
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    printf("Socket path is too long: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+
+  int notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (notify_fd < 0) {
+    perror("inotify_init1");
+    return EXIT_FAILURE;
+  }
+
+  struct followed_file *followed = calloc(num_files, sizeof(struct followed_file));
+  if (followed == NULL) {
+    printf("Not enough memory to analyze the files.\n");
+    close(notify_fd);
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < num_files; ++i) {
+    followed[i].path = files[i];
+    followed[i].watch = -1;
+    followed[i].fileptr = fopen(files[i], "r");
+
+    printf("Opening file: %s\n", files[i]);
+    if (followed[i].fileptr == NULL) {
+      printf("File cannot be opened.\n");
+      continue;
+    }
+    followed[i].watch = inotify_add_watch(notify_fd, files[i], IN_MODIFY);
+    if (followed[i].watch < 0) {
+      printf("File cannot be followed, only its current contents are used.\n");
+    }
+    follow_file(&followed[i], ctx);
+  }
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+  unlink(socket_path);
+  if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0
+      || listen(listen_fd, 16) < 0) {
+    perror(socket_path);
+    if (listen_fd >= 0) {
+      close(listen_fd);
+    }
+    close(notify_fd);
+    for (int i = 0; i < num_files; ++i) {
+      if (followed[i].fileptr != NULL) {
+        fclose(followed[i].fileptr);
       }
+    }
+    free(followed);
+    return EXIT_FAILURE;
   }
-  printf("\n");
+  printf("Listening on %s\n", socket_path);
+  fflush(stdout);
 
-  for (int i = 0; i < num_states; i++) {
-    if (states[i] != NULL){
-      printf("-- State: %s --\n", (*states + i)->code);
-      printf("Number of Records: %ld\n", (*states + i)->num_records);
-      printf("Average Humidity: %.1f%%\n", (double) (*states + i)->sum_humidity/(*states + i)->num_records);
-      double avg_temp = (*states + i)->sum_temp/(*states + i)->num_records;
-      printf("Average Temperature: %.1fF\n", avg_temp);
-      printf("Max Temperature: %.1fF\n", (double) (*states + i)->max_temp);
-      printf("Max Temperature on: %s\n", (*states + i)->max_temp_time);
-      printf("Min Temperature: %.1fF\n", (double) (*states + i)->min_temp);
-      printf("Min Temperature on: %s\n", (*states + i)->min_temp_time);
-      printf("Lightning Strikes: %.lu\n", (*states + i)->sum_strikes);
-      printf("Records with Snow Cover: %.lu\n", (*states + i)->sum_snow);
-      printf("Average Cloud Cover: %.1f%%\n", (double) (*states + i) ->sum_cloud/(*states + i)->num_records);
+  //no SA_RESTART, so poll() returns early when we are asked to stop
+  struct sigaction action = { 0 };
+  action.sa_handler = handle_stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  /* fds[0] and fds[1] are inotify and the listening socket, the rest are
+   * the pending clients in the same order as clients[] */
+  struct pollfd fds[2 + MAX_CLIENTS] = {
+    { .fd = notify_fd, .events = POLLIN },
+    { .fd = listen_fd, .events = POLLIN },
+  };
+  struct pending_client clients[MAX_CLIENTS];
+  int num_clients = 0;
+  while (!daemon_stop) {
+    //wakes up in time to drop the client that has waited the longest
+    int timeout = -1;
+    long long now = now_ms();
+    for (int c = 0; c < num_clients; ++c) {
+      long long left = clients[c].deadline > now ? clients[c].deadline - now : 0;
+      if (timeout < 0 || left < timeout) {
+        timeout = (int) left;
+      }
+    }
+    for (int c = 0; c < num_clients; ++c) {
+      fds[2 + c].fd = clients[c].fd;
+      fds[2 + c].events = POLLIN;
+      fds[2 + c].revents = 0;
+    }
+
+    if (poll(fds, 2 + num_clients, timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll");
+      break;
+    }
+
+    //catches up on every file that changed before answering anything
+    if (fds[0].revents & POLLIN) {
+      char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+      ssize_t len;
+      while ((len = read(notify_fd, events, sizeof(events))) > 0) {
+        const struct inotify_event *event;
+        for (char *ptr = events; ptr < events + len;
+             ptr += sizeof(struct inotify_event) + event->len) {
+          event = (const struct inotify_event*) ptr;
+          for (int i = 0; i < num_files; ++i) {
+            if (followed[i].watch == event->wd) {
+              follow_file(&followed[i], ctx);
+            }
+          }
+        }
+      }
+    }
+
+    /* Answers the clients whose query is complete and drops the ones that
+     * hung up or ran out of time, keeping clients[] packed */
+    now = now_ms();
+    int kept = 0;
+    for (int c = 0; c < num_clients; ++c) {
+      int done = 0;
+      if (fds[2 + c].revents & (POLLIN | POLLHUP | POLLERR)) {
+        done = read_query(&clients[c]);
+        if (done > 0) {
+          answer_query(clients[c].fd, clients[c].query, ctx, dedup);
+        }
+      }
+      if (done == 0 && now >= clients[c].deadline) {
+        done = -1;
+      }
+      if (done < 0) {
+        close(clients[c].fd);
+      } else if (done == 0) {
+        clients[kept++] = clients[c];
+      }
+    }
+    num_clients = kept;
+
+    if (fds[1].revents & POLLIN) {
+      int client;
+      while ((client = accept(listen_fd, NULL, NULL)) >= 0) {
+        //a flood of idle connections pushes out the oldest, not new queries
+        if (num_clients == MAX_CLIENTS) {
+          close(clients[0].fd);
+          memmove(&clients[0], &clients[1], (MAX_CLIENTS - 1) * sizeof(clients[0]));
+          num_clients--;
+        }
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        clients[num_clients].fd = client;
+        clients[num_clients].len = 0;
+        clients[num_clients].deadline = now_ms() + CLIENT_TIMEOUT_MS;
+        num_clients++;
+      }
+    }
+  }
+
+  for (int c = 0; c < num_clients; ++c) {
+    close(clients[c].fd);
+  }
+  close(listen_fd);
+  unlink(socket_path);
+  close(notify_fd);
+  for (int i = 0; i < num_files; ++i) {
+    if (followed[i].fileptr != NULL) {
+      fclose(followed[i].fileptr);
+    }
+  }
+  free(followed);
+  return 0;
+}
+
+/* Pushes the complete lines added to the file since the last call. offset
+ * only moves past whole lines, so a line that is still being written is
+ * read again once its newline arrives and nothing is left pending in the
+ * context, which is shared by all the followed files. */
+void follow_file(struct followed_file *followed, struct climate_ctx *ctx) {
+  char buf[READ_SZ];
+  size_t len;
+
+  //the file was truncated or replaced in place, start over
+  fseek(followed->fileptr, 0, SEEK_END);
+  if (ftell(followed->fileptr) < followed->offset) {
+    followed->offset = 0;
+    followed->skipping = 0;
+  }
+
+  fseek(followed->fileptr, followed->offset, SEEK_SET);
+  while ((len = fread(buf, 1, sizeof(buf), followed->fileptr)) > 0) {
+    //drops the rest of an overlong line, up to and including its newline
+    if (followed->skipping) {
+      char *newline = memchr(buf, '\n', len);
+      if (newline == NULL) {
+        followed->offset += len;
+        continue;
+      }
+      followed->skipping = 0;
+      followed->offset += newline - buf + 1;
+      fseek(followed->fileptr, followed->offset, SEEK_SET);
+      continue;
+    }
+
+    size_t complete = len;
+    while (complete > 0 && buf[complete - 1] != '\n') {
+      complete--;
     }
+    if (complete == 0) {
+      //a full buffer with no newline is no TDV record, skip the line
+      if (len == sizeof(buf)) {
+        followed->offset += len;
+        followed->skipping = 1;
+        continue;
+      }
+      break;
+    }
+    climate_ctx_push(ctx, buf, complete);
+    followed->offset += complete;
+    fseek(followed->fileptr, followed->offset, SEEK_SET);
+  }
+  clearerr(followed->fileptr);
+}
+
+/* Reads what has arrived of the client's query without blocking. Returns 1
+ * once the query is complete (a newline, the client closing its end or a
+ * full buffer), 0 if more is to come and -1 if the client is gone. */
+int read_query(struct pending_client *client) {
+  ssize_t len = recv(client->fd, client->query + client->len,
+                     sizeof(client->query) - 1 - client->len, 0);
+  if (len < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+  }
+  if (len == 0) {
+    return client->len > 0 ? 1 : -1;
+  }
+  client->len += len;
+  client->query[client->len] = '\0';
+  if (memchr(client->query, '\n', client->len) != NULL
+      || client->len == sizeof(client->query) - 1) {
+    return 1;
   }
+  return 0;
 }
 
-//Converts Kelvin to Fahrenheit
-double KtoF(double K) {
-    return K * 1.8 - 459.67;
+/* Writes the answer to a complete query and closes the connection. The
+ * socket is non-blocking, the answer is small enough for its buffer. */
+void answer_query(int client, const char *query_buf, struct climate_ctx *ctx,
+                  int dedup) {
+  FILE *out = fdopen(client, "w");
+  if (out == NULL) {
+    close(client);
+    return;
+  }
+  char query[64];
+  strcpy(query, query_buf);
+  query[strcspn(query, "\r\n")] = '\0';
+
+  struct climate_snapshot snap;
+  climate_ctx_snapshot(ctx, &snap);
+  if (!strcmp(query, "report")) {
+    if (dedup) {
+      fprintf(out, "Duplicate records dropped: %lu\n", snap.num_dropped);
+    }
+    print_report(out, &snap);
+  } else if (!strncmp(query, "state ", 6)) {
+    int found = 0;
+    for (int i = 0; i < snap.num_states && !found; i++) {
+      if (!strcmp(snap.states[i].code, query + 6)) {
+        print_state(out, &snap.states[i]);
+        found = 1;
+      }
+    }
+    if (!found) {
+      fprintf(out, "State not found: %s\n", query + 6);
+    }
+  } else {
+    fprintf(out, "Unknown query: %s\n", query);
+  }
+  fclose(out);
 }
 
-//Converts UNIX time to ctime
-char* timeToString(char* time) {
-    time_t timestamp = atol(time) / 1000;
-    char* timestamp_string = calloc(40, sizeof(char));
-    strcpy(timestamp_string, ctime(&timestamp));
-    //printf("here3\n");
-    return strtok(timestamp_string, "\n");
+//Converts UNIX time to ctime format in buf (at least 26 bytes)
+char* timeToString(time_t timestamp, char *buf) {
+    ctime_r(&timestamp, buf);
     //strips trailing newline that is added by ctime
+    buf[strcspn(buf, "\n")] = '\0';
+    return buf;
+}
+
+//Milliseconds on the monotonic clock, for client timeouts
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//Returns the size of a file in bytes, or -1 if it cannot be opened
+long file_size(const char *path) {
+    FILE* fileptr = fopen(path, "r");
+    if (fileptr == NULL) {
+        return -1;
+    }
+    fseek(fileptr, 0, SEEK_END);
+    long size = ftell(fileptr);
+    fclose(fileptr);
+    return size;
 }
@@ -0,0 +1,338 @@
+/* libclimate.c
+ *
+ * Reentrant implementation of libclimate.h. All state lives in the
+ * context; records are tokenized with strtok_r and timestamps are kept
+ * as time_t, so nothing here touches static buffers.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libclimate.h"
+
+/* Longest TDV line kept, including the newline and '\0'. Longer lines
+ * are cut short. */
+#define LINE_SZ 256
+
+/* Identifies a single observation. Two records with the same key are
+ * considered duplicates of each other. */
+struct record_key {
+    long long timestamp;
+    char code[3];
+    char geohash[13];
+};
+
+/* Open-addressing (linear probing) hash set of record keys. An empty slot
+ * has code[0] == '\0'. capacity is always a power of two. */
+struct record_set {
+    struct record_key *slots;
+    unsigned long capacity;
+    unsigned long size;
+};
+
+struct climate_ctx {
+    pthread_mutex_t lock;
+    int num_states;
+    struct climate_info states[CLIMATE_NUM_STATES];
+    struct record_set *seen;      //NULL unless CLIMATE_DEDUP
+    unsigned long num_dropped;
+    int dedup_failed;
+    char partial[LINE_SZ];        //incomplete line from the last push
+    size_t partial_len;
+};
+
+static struct record_set* record_set_create(unsigned long expected);
+static int record_set_insert(struct record_set *set, const struct record_key *key);
+static void record_set_free(struct record_set *set);
+
+
+struct climate_ctx* climate_ctx_create(int flags, unsigned long expected_records) {
+  struct climate_ctx *ctx = calloc(1, sizeof(struct climate_ctx));
+  if (ctx == NULL) {
+    return NULL;
+  }
+  if (flags & CLIMATE_DEDUP) {
+    ctx->seen = record_set_create(expected_records);
+    if (ctx->seen == NULL) {
+      free(ctx);
+      return NULL;
+    }
+  }
+  pthread_mutex_init(&ctx->lock, NULL);
+  return ctx;
+}
+
+void climate_ctx_destroy(struct climate_ctx *ctx) {
+  if (ctx == NULL) {
+    return;
+  }
+  if (ctx->seen != NULL) {
+    record_set_free(ctx->seen);
+  }
+  pthread_mutex_destroy(&ctx->lock);
+  free(ctx);
+}
+
+//Converts Kelvin to Fahrenheit
+static double KtoF(double K) {
+    return K * 1.8 - 459.67;
+}
+
+//Returns the state entry for code, creating it if needed (NULL if full)
+static struct climate_info* find_state(struct climate_info states[], int *num_states,
+                                       const char *code) {
+  for (int i = 0; i < *num_states; i++){
+    if (!strcmp(states[i].code, code)){
+      return &states[i];
+    }
+  }
+  if (*num_states == CLIMATE_NUM_STATES) {
+    return NULL;
+  }
+
+  struct climate_info *info = &states[(*num_states)++];
+  memset(info, 0, sizeof(*info));
+  strncpy(info->code, code, sizeof(info->code) - 1);
+
+  /* Not an elegant way to set default values for temperatures, but
+  the temperatures set to values that are are out of this world so 
+  that the first temperature processed from the file will act as default */ 
+  info->max_temp = -1000;
+  info->min_temp = 1000;
+  return info;
+}
+
+//Tokenizes one TDV record and adds it to the matching state
+static void analyze_line(struct climate_ctx *ctx, char *line) {
+  char *rest;
+  char *code = strtok_r(line, " \t\n", &rest);       //state code
+  char *temp_time = strtok_r(NULL, " \t\n", &rest);  //time of observation
+  char *geohash = strtok_r(NULL, " \t\n", &rest);    //geolocation
+  char *humidity = strtok_r(NULL, " \t\n", &rest);
+  char *snow = strtok_r(NULL, " \t\n", &rest);
+  char *cloud = strtok_r(NULL, " \t\n", &rest);
+  char *lightning = strtok_r(NULL, " \t\n", &rest);
+  char *pressure = strtok_r(NULL, " \t\n", &rest);   //unused
+  char *surface_temp = strtok_r(NULL, " \t\n", &rest);
+
+  //skips blank and malformed lines
+  if (surface_temp == NULL || pressure == NULL) {
+    return;
+  }
+
+  //skips records that were already counted
+  if (ctx->seen != NULL) {
+    struct record_key key = { 0 };
+    key.timestamp = atoll(temp_time);
+    strncpy(key.code, code, sizeof(key.code) - 1);
+    strncpy(key.geohash, geohash, sizeof(key.geohash) - 1);
+    int inserted = record_set_insert(ctx->seen, &key);
+    if (inserted == 0) {
+      ctx->num_dropped += 1;
+      return;
+    }
+    if (inserted < 0) {
+      ctx->dedup_failed = 1;
+    }
+  }
+
+  struct climate_info *info = find_state(ctx->states, &ctx->num_states, code);
+  if (info == NULL) {
+    return;
+  }
+
+  info->num_records += 1;
+  info->sum_humidity += atol(humidity);
+  if (atol(snow)) {
+    info->sum_snow += 1;
+  }
+  info->sum_cloud += atol(cloud);
+  if (atol(lightning)) {
+    info->sum_strikes += 1;
+  }
+
+  double temp_F = KtoF(atof(surface_temp)); //converted to Fahrenheit
+  time_t timestamp = atol(temp_time) / 1000;
+  info->sum_temp += temp_F;
+  if (temp_F > info->max_temp){ //set max temp
+    info->max_temp = temp_F;
+    info->max_temp_time = timestamp;
+  }
+  if (temp_F < info->min_temp){ //set min temp
+    info->min_temp = temp_F;
+    info->min_temp_time = timestamp;
+  }
+}
+
+//Appends up to len bytes to the partial line, cutting it at LINE_SZ - 1
+static void append_partial(struct climate_ctx *ctx, const char *buf, size_t len) {
+  size_t room = sizeof(ctx->partial) - 1 - ctx->partial_len;
+  if (len > room) {
+    len = room;
+  }
+  memcpy(ctx->partial + ctx->partial_len, buf, len);
+  ctx->partial_len += len;
+}
+
+int climate_ctx_push(struct climate_ctx *ctx, const char *buf, size_t len) {
+  pthread_mutex_lock(&ctx->lock);
+  while (len > 0) {
+    const char *newline = memchr(buf, '\n', len);
+    size_t take = newline != NULL ? (size_t) (newline - buf) + 1 : len;
+    append_partial(ctx, buf, take);
+    if (newline != NULL) {
+      ctx->partial[ctx->partial_len] = '\0';
+      analyze_line(ctx, ctx->partial);
+      ctx->partial_len = 0;
+    }
+    buf += take;
+    len -= take;
+  }
+  int status = ctx->dedup_failed ? -1 : 0;
+  ctx->dedup_failed = 0;
+  pthread_mutex_unlock(&ctx->lock);
+  return status;
+}
+
+void climate_ctx_flush(struct climate_ctx *ctx) {
+  pthread_mutex_lock(&ctx->lock);
+  if (ctx->partial_len > 0) {
+    ctx->partial[ctx->partial_len] = '\0';
+    analyze_line(ctx, ctx->partial);
+    ctx->partial_len = 0;
+  }
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+int climate_ctx_merge(struct climate_ctx *dst, struct climate_ctx *src) {
+  if (dst == src) {
+    return -1;
+  }
+
+  //always locks in the same order so two opposite merges cannot deadlock
+  struct climate_ctx *first = dst < src ? dst : src;
+  struct climate_ctx *second = dst < src ? src : dst;
+  pthread_mutex_lock(&first->lock);
+  pthread_mutex_lock(&second->lock);
+
+  int status = 0;
+  for (int i = 0; i < src->num_states; i++) {
+    const struct climate_info *from = &src->states[i];
+    struct climate_info *to = find_state(dst->states, &dst->num_states, from->code);
+    if (to == NULL) {
+      status = -1;
+      continue;
+    }
+    to->num_records += from->num_records;
+    to->sum_temp += from->sum_temp;
+    to->sum_humidity += from->sum_humidity;
+    to->sum_strikes += from->sum_strikes;
+    to->sum_snow += from->sum_snow;
+    to->sum_cloud += from->sum_cloud;
+    if (from->max_temp > to->max_temp) {
+      to->max_temp = from->max_temp;
+      to->max_temp_time = from->max_temp_time;
+    }
+    if (from->min_temp < to->min_temp) {
+      to->min_temp = from->min_temp;
+      to->min_temp_time = from->min_temp_time;
+    }
+  }
+  dst->num_dropped += src->num_dropped;
+
+  pthread_mutex_unlock(&second->lock);
+  pthread_mutex_unlock(&first->lock);
+  return status;
+}
+
+void climate_ctx_snapshot(struct climate_ctx *ctx, struct climate_snapshot *snap) {
+  pthread_mutex_lock(&ctx->lock);
+  snap->num_states = ctx->num_states;
+  snap->num_dropped = ctx->num_dropped;
+  memcpy(snap->states, ctx->states, ctx->num_states * sizeof(struct climate_info));
+  pthread_mutex_unlock(&ctx->lock);
+}
+
+//FNV-1a hash over the fields of a record key
+static unsigned long record_key_hash(const struct record_key *key) {
+    unsigned long long hash = 14695981039346656037ULL;
+    const unsigned char *bytes = (const unsigned char *) &key->timestamp;
+    for (size_t i = 0; i < sizeof(key->timestamp); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    for (const char *c = key->code; *c; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+    for (const char *c = key->geohash; *c; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+    return (unsigned long) (hash ^ (hash >> 32));
+}
+
+//Creates a set with room for about `expected` keys before it has to grow
+static struct record_set* record_set_create(unsigned long expected) {
+    struct record_set *set = calloc(1, sizeof(struct record_set));
+    if (set == NULL) {
+        return NULL;
+    }
+    //keeps the load factor at or below 1/2
+    set->capacity = 16;
+    while (set->capacity < expected * 2) {
+        set->capacity *= 2;
+    }
+    set->slots = calloc(set->capacity, sizeof(struct record_key));
+    if (set->slots == NULL) {
+        free(set);
+        return NULL;
+    }
+    return set;
+}
+
+//Doubles the table and re-inserts every key
+static int record_set_grow(struct record_set *set) {
+    unsigned long new_capacity = set->capacity * 2;
+    struct record_key *new_slots = calloc(new_capacity, sizeof(struct record_key));
+    if (new_slots == NULL) {
+        return 0;
+    }
+    for (unsigned long i = 0; i < set->capacity; i++) {
+        if (set->slots[i].code[0] != '\0') {
+            unsigned long j = record_key_hash(&set->slots[i]) & (new_capacity - 1);
+            while (new_slots[j].code[0] != '\0') {
+                j = (j + 1) & (new_capacity - 1);
+            }
+            new_slots[j] = set->slots[i];
+        }
+    }
+    free(set->slots);
+    set->slots = new_slots;
+    set->capacity = new_capacity;
+    return 1;
+}
+
+/* Adds key to the set. Returns 1 if the key was new, 0 if it was already
+ * present. If the set cannot grow it returns -1 and the key is treated as
+ * new, so records are never dropped by mistake. */
+static int record_set_insert(struct record_set *set, const struct record_key *key) {
+    if ((set->size + 1) * 10 > set->capacity * 7 && !record_set_grow(set)) {
+        return -1;
+    }
+    unsigned long i = record_key_hash(key) & (set->capacity - 1);
+    while (set->slots[i].code[0] != '\0') {
+        struct record_key *slot = &set->slots[i];
+        if (slot->timestamp == key->timestamp && !strcmp(slot->code, key->code)
+            && !strcmp(slot->geohash, key->geohash)) {
+            return 0;
+        }
+        i = (i + 1) & (set->capacity - 1);
+    }
+    set->slots[i] = *key;
+    set->size++;
+    return 1;
+}
+
+static void record_set_free(struct record_set *set) {
+    free(set->slots);
+    free(set);
+}
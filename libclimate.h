@@ -0,0 +1,81 @@
+/* libclimate.h
+ *
+ * Embeddable core of climate: aggregates NOAA TDV records (see the
+ * format in climate.c) pushed in as raw bytes, with no global state.
+ *
+ * Typical use:
+ *
+ *     struct climate_ctx *ctx = climate_ctx_create(0, 0);
+ *     climate_ctx_push(ctx, buf, len);      // any number of times
+ *     climate_ctx_flush(ctx);               // end of input
+ *     struct climate_snapshot snap;
+ *     climate_ctx_snapshot(ctx, &snap);
+ *     climate_ctx_destroy(ctx);
+ *
+ * Every function may be called from any thread; calls on the same
+ * context are serialized by a lock inside it, calls on different
+ * contexts never contend.  Contexts filled in separate threads can be
+ * combined with climate_ctx_merge.
+ */
+
+#ifndef LIBCLIMATE_H
+#define LIBCLIMATE_H
+
+#include <stddef.h>
+#include <time.h>
+
+#define CLIMATE_NUM_STATES 50
+
+/* Flags for climate_ctx_create */
+#define CLIMATE_DEDUP 1   /* drop repeated (state, timestamp, geohash) */
+
+/* Totals for one state. Averages are the sums divided by
+ * num_records. */
+struct climate_info {
+    char code[3];
+    unsigned long num_records;
+    double sum_temp;
+    double max_temp;
+    double min_temp;
+    time_t max_temp_time;
+    time_t min_temp_time;
+    unsigned long sum_humidity;
+    unsigned long sum_strikes;
+    unsigned long sum_snow;
+    unsigned long sum_cloud;
+};
+
+/* A copy of a context's results. States are in the order they were
+ * first seen. */
+struct climate_snapshot {
+    int num_states;
+    unsigned long num_dropped;
+    struct climate_info states[CLIMATE_NUM_STATES];
+};
+
+struct climate_ctx;
+
+/* Creates an empty context. With CLIMATE_DEDUP, expected_records sizes
+ * the duplicate filter (0 if unknown). Returns NULL if out of memory. */
+struct climate_ctx* climate_ctx_create(int flags, unsigned long expected_records);
+
+void climate_ctx_destroy(struct climate_ctx *ctx);
+
+/* Adds len bytes of TDV data. Records may be split anywhere across
+ * pushes; a trailing incomplete line is kept until the next push.
+ * Returns 0, or -1 if the duplicate filter ran out of memory (the
+ * records are still counted). */
+int climate_ctx_push(struct climate_ctx *ctx, const char *buf, size_t len);
+
+/* Counts a trailing line that has no newline, at the end of input */
+void climate_ctx_flush(struct climate_ctx *ctx);
+
+/* Adds the totals of src into dst. Duplicates are only detected within
+ * a context, not between merged ones. Returns 0, or -1 if dst would
+ * need more than CLIMATE_NUM_STATES states (those states are left
+ * out). */
+int climate_ctx_merge(struct climate_ctx *dst, struct climate_ctx *src);
+
+void climate_ctx_snapshot(struct climate_ctx *ctx, struct climate_snapshot *snap);
+
+#endif